@@ -0,0 +1,245 @@
+// Microbenchmarks of the parameter name equality and hashing (luafile_key_ops.h)
+//
+// The names imitate flattened configurations: 40 to 100 bytes, long common prefixes.
+// The hash values are checked first (the program fails if they differ from the scalar code).
+// Build with different flags to compare the instruction sets, e.g.
+//   make run-bench BENCH_FLAGS="-O2 -mavx2"
+//   make run-bench BENCH_FLAGS="-O2 -DLUAFILE_MAP_NO_SIMD"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "luafile_key_ops.h"
+
+// keeps the compiler from removing the measured code
+static volatile size_t sink;
+
+// Generate names like the flattened tables of a platform description
+static std::vector<std::string> makeKeys() {
+    static const char* cache_fields[] = { "size", "associativity", "hit_latency", "replacement_policy" };
+    static const char* timing_fields[] = { "tRCD", "tRP", "tRAS", "refresh_interval_ns" };
+    std::vector<std::string> keys;
+    char name[256];
+    for (int cluster = 0; cluster < 8; ++cluster) {
+        for (int cpu = 0; cpu < 32; ++cpu) {
+            for (int level = 1; level <= 3; ++level) {
+                for (int field = 0; field < 4; ++field) {
+                    snprintf(name, sizeof(name), "platform.soc.cluster%d.cpu.%d.memory_hierarchy.cache.l%d.%s",
+                             cluster, cpu, level, cache_fields[field]);
+                    keys.push_back(name);
+                }
+            }
+        }
+    }
+    for (int channel = 0; channel < 16; ++channel) {
+        for (int rank = 0; rank < 8; ++rank) {
+            for (int field = 0; field < 4; ++field) {
+                snprintf(name, sizeof(name), "platform.memory.dram_controller.channel.%d.rank.%d.timing_parameters.%s",
+                         channel, rank, timing_fields[field]);
+                keys.push_back(name);
+            }
+        }
+    }
+    for (int router = 0; router < 64; ++router) {
+        for (int port = 0; port < 5; ++port) {
+            snprintf(name, sizeof(name), "platform.interconnect.noc.router.%d.port.%d.virtual_channel_buffer_depth",
+                     router, port);
+            keys.push_back(name);
+        }
+    }
+    return keys;
+}
+
+// Check LuaFileMap_KeyOps::hash against values of the scalar code, so that a
+// difference between the SSE2, AVX2 and scalar paths shows up
+static bool checkHashes(const std::vector<std::string>& keys) {
+    struct Expected {
+        const char* name;
+        uint64_t hash;
+    };
+    static const Expected expected[] = {
+        { "", 0x534e859d4546eea2ULL },
+        { "a", 0xff6bf7452d76fa96ULL },
+        { "cores", 0xae0f3f5bc9571660ULL },
+        { "platform.soc.cluster0.cpu.0.l2.", 0xd61c001f48657eaaULL },    // 31 bytes
+        { "platform.soc.cluster0.cpu.0.l2.s", 0x8b47218c7ba71831ULL },   // 32 bytes
+        { "platform.soc.cluster0.cpu.0.l2.sz", 0xb38323e05e728ac8ULL },  // 33 bytes
+    };
+    bool ok = true;
+    for (size_t i = 0; i < sizeof(expected) / sizeof(expected[0]); ++i) {
+        uint64_t hash = LuaFileMap_KeyOps::hash(expected[i].name, strlen(expected[i].name));
+        if (hash != expected[i].hash) {
+            std::cout << "hash mismatch for \"" << expected[i].name << "\"" << std::endl;
+            ok = false;
+        }
+    }
+
+    // all the benchmark names
+    uint64_t combined = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        combined = combined * 31 + LuaFileMap_KeyOps::hash(keys[i].data(), keys[i].size());
+    }
+    if (combined != 0xefabe94da0ad03bcULL) {
+        std::cout << "hash mismatch for the benchmark names" << std::endl;
+        ok = false;
+    }
+
+    // the same 32 byte blocks in another order must not collide
+    std::string a(32, 'a'), b(32, 'b'), tail(33, 't');
+    std::string ab = a + b + tail, ba = b + a + tail;
+    if (LuaFileMap_KeyOps::hash(ab.data(), ab.size()) == LuaFileMap_KeyOps::hash(ba.data(), ba.size())) {
+        std::cout << "hash does not depend on the order of the blocks" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+// Shuffle without depending on the standard library implementation
+static void shuffle(std::vector<std::string>& keys) {
+    uint32_t state = 12345;
+    for (size_t i = keys.size() - 1; i > 0; --i) {
+        state = state * 1664525u + 1013904223u;
+        std::swap(keys[i], keys[state % (i + 1)]);
+    }
+}
+
+// Run f 'repeat' times and print the time per operation
+template<typename F>
+static void measure(const char* name, size_t operations, int repeat, F f) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeat; ++r) {
+        f();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "  " << std::left << std::setw(46) << name << std::right << std::fixed
+              << std::setprecision(2) << std::setw(8) << elapsed.count() / (operations * repeat)
+              << " ns/op" << std::endl;
+}
+
+// The filters replaced by LuaFileMap_ReservedNames
+static bool reservedByStrcmp(const char* key) {
+    return strcmp(key, "math.huge") == 0 || strcmp(key, "math.pi") == 0 ||
+           strcmp(key, "_VERSION") == 0 || strcmp(key, "package.cpath") == 0 ||
+           strcmp(key, "package.config") == 0 || strcmp(key, "package.path") == 0;
+}
+
+int main() {
+    std::vector<std::string> keys = makeKeys();
+    std::vector<std::string> lookup_keys = keys;  // separate copies, as lookups do not share the map storage
+    shuffle(lookup_keys);
+
+    size_t total_length = 0;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        total_length += keys[i].size();
+    }
+#if defined(LUAFILE_MAP_AVX2)
+    const char* isa = "AVX2";
+#elif defined(LUAFILE_MAP_SSE2)
+    const char* isa = "SSE2";
+#else
+    const char* isa = "scalar";
+#endif
+    std::cout << keys.size() << " keys, average length " << total_length / keys.size()
+              << " bytes, key operations: " << isa << std::endl;
+
+    if (!checkHashes(keys)) {
+        return 1;
+    }
+    std::cout << "hash values: ok" << std::endl;
+
+    const int repeat = 200;
+
+    std::cout << "\nequality of equal names (full length scan)" << std::endl;
+    measure("std::string operator==", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sink = sink + (keys[i] == lookup_keys[i]);
+        }
+    });
+    measure("LuaFileMap_KeyOps::equal", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sink = sink + LuaFileMap_KeyOps::equal(keys[i].data(), keys[i].size(),
+                                                   lookup_keys[i].data(), lookup_keys[i].size());
+        }
+    });
+
+    std::cout << "\nhash" << std::endl;
+    measure("std::hash<std::string>", keys.size(), repeat, [&]() {
+        std::hash<std::string> hasher;
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sink = sink + hasher(keys[i]);
+        }
+    });
+    measure("LuaFileMap_KeyOps::hash", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sink = sink + LuaFileMap_KeyOps::hash(keys[i].data(), keys[i].size());
+        }
+    });
+
+    std::cout << "\ngetter lookups by const char* (two finds, as the cross-type getters)" << std::endl;
+    std::map<std::string, long> std_map;
+    std::unordered_map<std::string, long, LuaFileMap_KeyHash, LuaFileMap_KeyEqual> tool_map;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        std_map[keys[i]] = (long)i;
+        tool_map[keys[i]] = (long)i;
+    }
+    measure("std::map, std::string built for each", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < lookup_keys.size(); ++i) {
+            const char* name = lookup_keys[i].c_str();
+            sink = sink + std_map.find(name)->second + (std_map.find(name) != std_map.end());
+        }
+    });
+    measure("std::map, std::string built once", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < lookup_keys.size(); ++i) {
+            std::string name(lookup_keys[i].c_str());
+            sink = sink + std_map.find(name)->second + (std_map.find(name) != std_map.end());
+        }
+    });
+    measure("LuaFileMap_Tool maps, std::string built once", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < lookup_keys.size(); ++i) {
+            std::string name(lookup_keys[i].c_str());
+            sink = sink + tool_map.find(name)->second + (tool_map.find(name) != tool_map.end());
+        }
+    });
+
+    std::cout << "\nunordered_map find (shuffled lookups)" << std::endl;
+    std::unordered_map<std::string, long> std_hash_map;
+    std::unordered_map<std::string, long, LuaFileMap_KeyHash, LuaFileMap_KeyEqual> key_hash_map;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        std_hash_map[keys[i]] = (long)i;
+        key_hash_map[keys[i]] = (long)i;
+    }
+    measure("std::hash + std::equal_to", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < lookup_keys.size(); ++i) {
+            sink = sink + std_hash_map.find(lookup_keys[i])->second;
+        }
+    });
+    measure("LuaFileMap_KeyHash + LuaFileMap_KeyEqual", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < lookup_keys.size(); ++i) {
+            sink = sink + key_hash_map.find(lookup_keys[i])->second;
+        }
+    });
+
+    std::cout << "\nreserved Lua name filter" << std::endl;
+    measure("strcmp chain", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sink = sink + reservedByStrcmp(keys[i].c_str());
+        }
+    });
+    measure("LuaFileMap_ReservedNames::contains", keys.size(), repeat, [&]() {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sink = sink + LuaFileMap_ReservedNames::contains(LuaFileMap_ReservedNames::STRING,
+                                                             keys[i].data(), keys[i].size());
+        }
+    });
+
+    return 0;
+}
@@ -4,6 +4,19 @@
 
 #include "luafile_map_tool.h"
 
+// Print the estimated memory usage of each parameter type
+static void printMemoryStats(const LuaFileMap_Tool::MemoryStats& stats) {
+    const char* names[] = { "double", "long", "string", "keys" };
+    const LuaFileMap_Tool::TypeMemoryStats* types[] = { &stats.doubles, &stats.longs, &stats.strings, &stats.keys };
+    for (int i = 0; i < 4; ++i) {
+        std::cout << "  " << names[i] << ": " << types[i]->entries << " entries, "
+                  << types[i]->key_bytes << " key bytes, "
+                  << types[i]->value_bytes << " value bytes, "
+                  << types[i]->overhead_bytes << " overhead bytes" << std::endl;
+    }
+    std::cout << "  total: " << stats.total() << " bytes" << std::endl;
+}
+
 int main(int argc, char *argv[]) {
     // Use the singleton instance of the LuaFileMap_Tool
     const char* configFile = "config.lua";  // Default config file
@@ -189,6 +202,25 @@ int main(int argc, char *argv[]) {
         std::cout << "Large integer value: " << large_int_value_val << std::endl;
     }
     
+    // Memory footprint and compaction
+    std::cout << "\n=== Memory Footprint ===" << std::endl;
+    printMemoryStats(luareader.memoryStats());
+    
+    // Compact the already loaded parameters (shared name prefixes and identical strings stored once)
+    LuaFileMap_Tool::instance(NULL, false, true);
+    const LuaFileMap_Tool::CompactionReport& report = luareader.getCompactionReport();
+    std::cout << "After compaction:" << std::endl;
+    printMemoryStats(report.after);
+    std::cout << "Saved " << report.savedBytes() << " of " << report.before.total() << " bytes" << std::endl;
+    
+    // Lookups keep working on the compacted parameters
+    std::string ram;
+    if (luareader.getString(ram, "memory.ram")) {
+        std::cout << "Memory ram (compacted): " << ram << std::endl;
+    } else {
+        std::cout << "Memory ram not found after compaction" << std::endl;
+    }
+    
     // Demonstrate cross-type access
     std::cout << "\n=== Demonstrating Cross-Type Access ===" << std::endl;
     std::cout << "Note: With cross-type lookup enabled:" << std::endl;
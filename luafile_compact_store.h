@@ -0,0 +1,420 @@
+//   Lua Configuration Map Tool
+//
+// LICENSETEXT
+//
+//   Copyright (C) 2007-2009 : Original authors
+//   Modified and simplified for general use
+//
+//
+// The contents of this file are subject to the licensing terms specified
+// in the file LICENSE. Please consult this file for restrictions and
+// limitations that may apply.
+//
+// ENDLICENSETEXT
+
+#ifndef __LUAFILE_COMPACT_STORE_H__
+#define __LUAFILE_COMPACT_STORE_H__
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "luafile_key_ops.h"
+
+  /// Estimated memory used by the parameters of one type
+  struct LuaFileMap_TypeMemoryStats
+  {
+    size_t entries;         ///< number of stored parameters
+    size_t key_bytes;       ///< characters of the parameter names
+    size_t value_bytes;     ///< value payload (sizeof the number, or the string characters)
+    size_t overhead_bytes;  ///< container nodes, string objects and heap slack
+
+    LuaFileMap_TypeMemoryStats() : entries(0), key_bytes(0), value_bytes(0), overhead_bytes(0) {}
+
+    size_t total() const { return key_bytes + value_bytes + overhead_bytes; }
+
+    /// Add the estimated memory of one container entry
+    /**
+     * @param value_bytes value payload
+     * @param entry_bytes whole entry: container node, key/value objects and their heap blocks
+     */
+    void addEntry(const std::string& key, size_t value_bytes, size_t entry_bytes)
+    {
+      entry_bytes += stringHeapBytes(key);
+      ++entries;
+      key_bytes += key.size();
+      this->value_bytes += value_bytes;
+      overhead_bytes += entry_bytes - key.size() - value_bytes;
+    }
+
+    /// Bytes allocated on the heap by a std::string (0 if it fits in the string object)
+    static size_t stringHeapBytes(const std::string& str)
+    {
+      static const size_t local_capacity = std::string().capacity();
+      return str.capacity() > local_capacity ? str.capacity() + 1 : 0;
+    }
+  };
+
+  /// Estimated memory used by all loaded parameters
+  /**
+   * When the configuration is compacted the parameter names are stored once for
+   * all types, so their cost is reported in 'keys' instead of in each type.
+   */
+  struct LuaFileMap_MemoryStats
+  {
+    LuaFileMap_TypeMemoryStats doubles;
+    LuaFileMap_TypeMemoryStats longs;
+    LuaFileMap_TypeMemoryStats strings;
+    LuaFileMap_TypeMemoryStats keys;   ///< interned name segments (only used when compacted)
+
+    size_t total() const
+    {
+      return doubles.total() + longs.total() + strings.total() + keys.total();
+    }
+  };
+
+  /// Memory usage before and after a compaction
+  struct LuaFileMap_CompactionReport
+  {
+    LuaFileMap_MemoryStats before;
+    LuaFileMap_MemoryStats after;
+
+    /// Bytes saved by the compaction (0 if it did not save anything)
+    size_t savedBytes() const
+    {
+      return before.total() > after.total() ? before.total() - after.total() : 0;
+    }
+  };
+
+  /// Compact storage of the parameters of LuaFileMap_Tool
+  /**
+   * Every name is split at the dots into a tree with one KeyNode per path segment,
+   * so a shared prefix like "cpu.17.cache" is stored once. Identical segments and
+   * identical string values are pooled and stored only once.
+   */
+  class LuaFileMap_CompactStore
+  {
+
+  public:
+    LuaFileMap_CompactStore()
+      : mStringCount(0)
+    {
+    }
+
+    /// Build the store from the maps of each type (replaces the current content)
+    template<typename DoubleMapT, typename LongMapT, typename StringMapT>
+    void build(const DoubleMapT& doubles, const LongMapT& longs, const StringMapT& strings)
+    {
+      clear();
+
+      // collect the names in a temporary tree (with value indexes) before laying it out
+      std::vector<BuildNode> tree(1);
+      for (typename DoubleMapT::const_iterator it = doubles.begin(); it != doubles.end(); ++it) {
+        tree[insertBuildPath(tree, it->first)].double_index = (int32_t)mDoubles.size();
+        mDoubles.push_back(it->second);
+      }
+      for (typename LongMapT::const_iterator it = longs.begin(); it != longs.end(); ++it) {
+        tree[insertBuildPath(tree, it->first)].long_index = (int32_t)mLongs.size();
+        mLongs.push_back(it->second);
+      }
+      PoolIndex value_ids;  // value -> index in mStrings
+      for (typename StringMapT::const_iterator it = strings.begin(); it != strings.end(); ++it) {
+        PoolIndex::iterator value_it = value_ids.find(it->second);
+        if (value_it == value_ids.end()) {
+          StringRef ref = { (uint32_t)mStringValuePool.size(), (uint32_t)it->second.size() };
+          mStringValuePool += it->second;
+          value_it = value_ids.insert(std::make_pair(it->second, (uint32_t)mStrings.size())).first;
+          mStrings.push_back(ref);
+        }
+        tree[insertBuildPath(tree, it->first)].string_index = (int32_t)value_it->second;
+        ++mStringCount;
+      }
+
+      // lay out the tree breadth first so that the children of a node are contiguous
+      // (and sorted, as they come from a std::map)
+      PoolIndex segment_offsets;
+      std::vector<uint32_t> order(1, 0);  // tree index of each KeyNode
+      mKeyNodes.assign(tree.size(), KeyNode());
+      for (size_t i = 0; i < order.size(); ++i) {
+        const BuildNode& build_node = tree[order[i]];
+        KeyNode& node = mKeyNodes[i];
+        node.first_child = (uint32_t)order.size();
+        node.child_count = (uint32_t)build_node.children.size();
+        node.double_index = build_node.double_index;
+        node.long_index = build_node.long_index;
+        node.string_index = build_node.string_index;
+        for (std::map<std::string, uint32_t>::const_iterator it = build_node.children.begin();
+             it != build_node.children.end(); ++it) {
+          KeyNode& child = mKeyNodes[order.size()];
+          child.segment_offset = internSegment(segment_offsets, it->first);
+          child.segment_length = (uint32_t)it->first.size();
+          order.push_back(it->second);
+        }
+      }
+
+      // release the unused capacity
+      std::vector<double>(mDoubles).swap(mDoubles);
+      std::vector<long>(mLongs).swap(mLongs);
+      std::vector<StringRef>(mStrings).swap(mStrings);
+      std::string(mStringValuePool).swap(mStringValuePool);
+      std::string(mSegmentPool).swap(mSegmentPool);
+    }
+
+    /// Add the parameters of the store to the maps of each type
+    template<typename DoubleMapT, typename LongMapT, typename StringMapT>
+    void expand(DoubleMapT& doubles, LongMapT& longs, StringMapT& strings) const
+    {
+      if (mKeyNodes.empty()) {
+        return;
+      }
+      std::string name;
+      expandNode(0, name, doubles, longs, strings);
+    }
+
+    /// Drop the content of the store
+    void clear()
+    {
+      std::vector<KeyNode>().swap(mKeyNodes);
+      std::vector<double>().swap(mDoubles);
+      std::vector<long>().swap(mLongs);
+      std::vector<StringRef>().swap(mStrings);
+      std::string().swap(mStringValuePool);
+      std::string().swap(mSegmentPool);
+      mStringCount = 0;
+    }
+
+    /// Look up a double parameter
+    bool findDouble(double& val, const char* param_name) const
+    {
+      uint32_t node = findNode(param_name);
+      if (node == 0 || mKeyNodes[node].double_index < 0) {
+        return false;
+      }
+      val = mDoubles[mKeyNodes[node].double_index];
+      return true;
+    }
+
+    /// Look up a long parameter
+    bool findLong(long& val, const char* param_name) const
+    {
+      uint32_t node = findNode(param_name);
+      if (node == 0 || mKeyNodes[node].long_index < 0) {
+        return false;
+      }
+      val = mLongs[mKeyNodes[node].long_index];
+      return true;
+    }
+
+    /// Look up a string parameter
+    bool findString(std::string& val, const char* param_name) const
+    {
+      uint32_t node = findNode(param_name);
+      if (node == 0 || mKeyNodes[node].string_index < 0) {
+        return false;
+      }
+      const StringRef& ref = mStrings[mKeyNodes[node].string_index];
+      val.assign(mStringValuePool, ref.offset, ref.length);
+      return true;
+    }
+
+    /// Estimate the memory used by the store
+    LuaFileMap_MemoryStats memoryStats() const
+    {
+      LuaFileMap_MemoryStats stats;
+      stats.doubles.entries = mDoubles.size();
+      stats.doubles.value_bytes = mDoubles.size() * sizeof(double);
+      stats.doubles.overhead_bytes = (mDoubles.capacity() - mDoubles.size()) * sizeof(double);
+
+      stats.longs.entries = mLongs.size();
+      stats.longs.value_bytes = mLongs.size() * sizeof(long);
+      stats.longs.overhead_bytes = (mLongs.capacity() - mLongs.size()) * sizeof(long);
+
+      stats.strings.entries = mStringCount;
+      stats.strings.value_bytes = mStringValuePool.size();
+      stats.strings.overhead_bytes = mStrings.capacity() * sizeof(StringRef)
+                                     + (mStringValuePool.capacity() - mStringValuePool.size());
+
+      stats.keys.entries = mKeyNodes.size();
+      stats.keys.key_bytes = mSegmentPool.size();
+      stats.keys.overhead_bytes = mKeyNodes.capacity() * sizeof(KeyNode)
+                                  + (mSegmentPool.capacity() - mSegmentPool.size());
+      return stats;
+    }
+
+  private:
+    /// One segment of a parameter name (the root node has an empty segment)
+    struct KeyNode
+    {
+      uint32_t first_child;     ///< index of the first child in mKeyNodes
+      uint32_t child_count;     ///< children are contiguous and sorted by segment
+      uint32_t segment_offset;  ///< segment characters in mSegmentPool
+      uint32_t segment_length;
+      int32_t double_index;     ///< value in mDoubles, -1 if none
+      int32_t long_index;       ///< value in mLongs, -1 if none
+      int32_t string_index;     ///< value in mStrings, -1 if none
+
+      KeyNode()
+        : first_child(0), child_count(0), segment_offset(0), segment_length(0),
+          double_index(-1), long_index(-1), string_index(-1) {}
+    };
+
+    /// A string value of the store
+    struct StringRef
+    {
+      uint32_t offset;  ///< characters in mStringValuePool
+      uint32_t length;
+    };
+
+    /// Texts already stored in a pool (only used by build())
+    typedef std::unordered_map<std::string, uint32_t, LuaFileMap_KeyHash, LuaFileMap_KeyEqual> PoolIndex;
+
+    /// Node of the temporary name tree used by build()
+    struct BuildNode
+    {
+      std::map<std::string, uint32_t> children;
+      int32_t double_index;
+      int32_t long_index;
+      int32_t string_index;
+
+      BuildNode() : double_index(-1), long_index(-1), string_index(-1) {}
+    };
+
+    std::vector<KeyNode> mKeyNodes;
+    std::string mSegmentPool;
+    std::vector<double> mDoubles;
+    std::vector<long> mLongs;
+    std::vector<StringRef> mStrings;
+    std::string mStringValuePool;
+    size_t mStringCount;  ///< string parameters (before value deduplication)
+
+    /// Walk the store segment by segment
+    /**
+     * @param param_name Dotted parameter name
+     * @return index of the node in mKeyNodes, 0 (the root) if not found
+     */
+    uint32_t findNode(const char* param_name) const
+    {
+      if (mKeyNodes.empty()) {
+        return 0;
+      }
+      uint32_t node = 0;
+      const char* segment = param_name;
+      for (;;) {
+        const char* dot = strchr(segment, '.');
+        size_t length = dot != NULL ? (size_t)(dot - segment) : strlen(segment);
+
+        // binary search among the children of the current node
+        uint32_t low = mKeyNodes[node].first_child;
+        uint32_t high = low + mKeyNodes[node].child_count;
+        uint32_t found = 0;
+        while (low < high) {
+          uint32_t mid = low + (high - low) / 2;
+          int cmp = compareSegment(mKeyNodes[mid], segment, length);
+          if (cmp < 0) {
+            low = mid + 1;
+          }
+          else if (cmp > 0) {
+            high = mid;
+          }
+          else {
+            found = mid;
+            break;
+          }
+        }
+        if (found == 0 || dot == NULL) {
+          return found;
+        }
+        node = found;
+        segment = dot + 1;
+      }
+    }
+
+    /// Compare the segment of a node with a name segment (same order as std::string)
+    int compareSegment(const KeyNode& node, const char* segment, size_t length) const
+    {
+      size_t common = node.segment_length < length ? node.segment_length : length;
+      int cmp = memcmp(mSegmentPool.data() + node.segment_offset, segment, common);
+      if (cmp != 0) {
+        return cmp;
+      }
+      return node.segment_length < length ? -1 : (node.segment_length > length ? 1 : 0);
+    }
+
+    /// Rebuild the names below a node into the maps (recursive)
+    template<typename DoubleMapT, typename LongMapT, typename StringMapT>
+    void expandNode(uint32_t index, std::string& name,
+                    DoubleMapT& doubles, LongMapT& longs, StringMapT& strings) const
+    {
+      const KeyNode& node = mKeyNodes[index];
+      if (node.double_index >= 0) {
+        doubles[name] = mDoubles[node.double_index];
+      }
+      if (node.long_index >= 0) {
+        longs[name] = mLongs[node.long_index];
+      }
+      if (node.string_index >= 0) {
+        const StringRef& ref = mStrings[node.string_index];
+        strings[name] = mStringValuePool.substr(ref.offset, ref.length);
+      }
+      for (uint32_t child = node.first_child; child < node.first_child + node.child_count; ++child) {
+        size_t length = name.size();
+        if (index != 0) {
+          name += '.';
+        }
+        name.append(mSegmentPool, mKeyNodes[child].segment_offset, mKeyNodes[child].segment_length);
+        expandNode(child, name, doubles, longs, strings);
+        name.resize(length);
+      }
+    }
+
+    /// Add the dotted name to the temporary tree of build()
+    /**
+     * @return index in the tree of the node of the last segment
+     */
+    static uint32_t insertBuildPath(std::vector<BuildNode>& tree, const std::string& name)
+    {
+      uint32_t node = 0;
+      size_t begin = 0;
+      for (;;) {
+        size_t dot = name.find('.', begin);
+        std::string segment = name.substr(begin, dot == std::string::npos ? std::string::npos : dot - begin);
+        std::map<std::string, uint32_t>::iterator it = tree[node].children.find(segment);
+        if (it == tree[node].children.end()) {
+          uint32_t child = (uint32_t)tree.size();
+          tree[node].children[segment] = child;
+          tree.push_back(BuildNode());
+          node = child;
+        }
+        else {
+          node = it->second;
+        }
+        if (dot == std::string::npos) {
+          return node;
+        }
+        begin = dot + 1;
+      }
+    }
+
+    /// Store a name segment once in mSegmentPool
+    /**
+     * @param offsets segment -> offset of the segments already in the pool
+     * @return offset of the segment in the pool
+     */
+    uint32_t internSegment(PoolIndex& offsets, const std::string& segment)
+    {
+      PoolIndex::iterator it = offsets.find(segment);
+      if (it != offsets.end()) {
+        return it->second;
+      }
+      uint32_t offset = (uint32_t)mSegmentPool.size();
+      mSegmentPool += segment;
+      offsets[segment] = offset;
+      return offset;
+    }
+  };
+
+#endif
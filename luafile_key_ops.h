@@ -0,0 +1,356 @@
+//   Lua Configuration Map Tool
+//
+// LICENSETEXT
+//
+//   Copyright (C) 2007-2009 : Original authors
+//   Modified and simplified for general use
+//
+//
+// The contents of this file are subject to the licensing terms specified
+// in the file LICENSE. Please consult this file for restrictions and
+// limitations that may apply.
+//
+// ENDLICENSETEXT
+
+#ifndef __LUAFILE_KEY_OPS_H__
+#define __LUAFILE_KEY_OPS_H__
+
+#include <string>
+#include <cstring>
+#include <stddef.h>
+#include <stdint.h>
+
+// Define LUAFILE_MAP_NO_SIMD (-DLUAFILE_MAP_NO_SIMD) to use the portable scalar code only.
+// Otherwise AVX2 is used if the compiler targets it (e.g. -mavx2 or -march=native), else SSE2.
+#ifndef LUAFILE_MAP_NO_SIMD
+# if defined(__AVX2__)
+#  define LUAFILE_MAP_AVX2
+#  define LUAFILE_MAP_SSE2
+# elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define LUAFILE_MAP_SSE2
+# endif
+#endif
+
+#if defined(LUAFILE_MAP_AVX2)
+# include <immintrin.h>
+#elif defined(LUAFILE_MAP_SSE2)
+# include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
+  /// Comparison and hashing of parameter names
+  /**
+   * Flattened parameter names ("cpu.17.cache.l2.size") are often long and share long
+   * prefixes, so these functions compare and hash 16 (SSE2) or 32 (AVX2) bytes at a time.
+   * hash() gives the same value with or without SIMD.
+   *
+   * They are used through LuaFileMap_KeyHash and LuaFileMap_KeyEqual by the parameter
+   * maps of LuaFileMap_Tool and by the pools of LuaFileMap_CompactStore.
+   */
+  class LuaFileMap_KeyOps
+  {
+
+  public:
+    /// Index of the first byte which differs between a and b (n if none)
+    static size_t firstMismatch(const char* a, const char* b, size_t n)
+    {
+      size_t i = 0;
+#if defined(LUAFILE_MAP_AVX2)
+      for (; i + 32 <= n; i += 32) {
+        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+        uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(va, vb)));
+        if (mask != 0) {
+          return i + countTrailingZeros(mask);
+        }
+      }
+#endif
+#if defined(LUAFILE_MAP_SSE2) && !defined(LUAFILE_MAP_AVX2)
+      for (; i + 32 <= n; i += 32) {
+        __m128i low = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                     _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m128i high = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)),
+                                      _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)));
+        if (_mm_movemask_epi8(_mm_and_si128(low, high)) != 0xFFFF) {
+          uint32_t mask = ~static_cast<uint32_t>(_mm_movemask_epi8(low) | (_mm_movemask_epi8(high) << 16));
+          return i + countTrailingZeros(mask);
+        }
+      }
+#endif
+#if defined(LUAFILE_MAP_SSE2)
+      for (; i + 16 <= n; i += 16) {
+        uint32_t mask = mismatchMask16(a + i, b + i);
+        if (mask != 0) {
+          return i + countTrailingZeros(mask);
+        }
+      }
+      if (i < n && n >= 16) {
+        // last bytes: load the final 16 bytes again (the ones before i are known to be equal)
+        uint32_t mask = mismatchMask16(a + n - 16, b + n - 16);
+        return mask != 0 ? n - 16 + countTrailingZeros(mask) : n;
+      }
+#else
+      for (; i + 8 <= n; i += 8) {
+        if (load64(a + i) != load64(b + i)) {
+          break;
+        }
+      }
+#endif
+      for (; i < n; ++i) {
+        if (a[i] != b[i]) {
+          return i;
+        }
+      }
+      return n;
+    }
+
+    /// True if both names are equal
+    static bool equal(const char* a, size_t a_length, const char* b, size_t b_length)
+    {
+      return a_length == b_length && firstMismatch(a, b, a_length) == a_length;
+    }
+
+    /// Hash a name, 32 bytes per step
+    /**
+     * Each step mixes four 64-bit lanes: lane k adds the other lane of its pair and
+     * the product of the low and high halves of (data ^ secret). The lanes are scrambled
+     * between steps so that the hash depends on the order of the blocks. The last step
+     * reads the final 32 bytes of the name (overlapping the previous step), or the name
+     * padded with zeros if it is shorter than 32 bytes.
+     */
+    static uint64_t hash(const char* s, size_t n)
+    {
+      static const uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+      static const uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+      static const uint64_t prime3 = 0x165667B19E3779F9ULL;
+      static const uint64_t init[4] = { prime1, prime2, prime3, prime1 ^ prime2 };
+      static const uint64_t secret[4] = {
+        0xBE4BA423396CFEB8ULL, 0x1CAD21F72C81017CULL, 0xDB979083E96DD4DEULL, 0x1F67B3B7A4A44072ULL
+      };
+
+      char padded[32];
+      const char* last = padded;
+      if (n >= 32) {
+        last = s + n - 32;
+      }
+      else {
+        memset(padded, 0, sizeof(padded));
+        memcpy(padded, s, n);
+      }
+
+      uint64_t acc[4];
+#if defined(LUAFILE_MAP_AVX2)
+      __m256i vacc = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(init));
+      const __m256i vsecret = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret));
+      for (size_t i = 0; i + 32 < n; i += 32) {
+        accumulate(vacc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)), vsecret);
+        scramble(vacc);
+      }
+      accumulate(vacc, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(last)), vsecret);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc), vacc);
+#elif defined(LUAFILE_MAP_SSE2)
+      __m128i vacc_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(init));
+      __m128i vacc_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(init + 2));
+      const __m128i vsecret_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret));
+      const __m128i vsecret_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret + 2));
+      for (size_t i = 0; i + 32 < n; i += 32) {
+        accumulate(vacc_low, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)), vsecret_low);
+        accumulate(vacc_high, _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 16)), vsecret_high);
+        scramble(vacc_low);
+        scramble(vacc_high);
+      }
+      accumulate(vacc_low, _mm_loadu_si128(reinterpret_cast<const __m128i*>(last)), vsecret_low);
+      accumulate(vacc_high, _mm_loadu_si128(reinterpret_cast<const __m128i*>(last + 16)), vsecret_high);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(acc), vacc_low);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(acc + 2), vacc_high);
+#else
+      memcpy(acc, init, sizeof(acc));
+      for (size_t i = 0; i + 32 < n; i += 32) {
+        accumulate(acc, s + i, secret);
+        scramble(acc);
+      }
+      accumulate(acc, last, secret);
+#endif
+
+      uint64_t h = static_cast<uint64_t>(n) * prime1
+                   + (acc[0] ^ rotateLeft(acc[1], 29)) * prime2
+                   + (acc[2] ^ rotateLeft(acc[3], 43)) * prime3;
+      h ^= h >> 33;
+      h *= prime2;
+      h ^= h >> 29;
+      return h;
+    }
+
+  private:
+    static const uint32_t SCRAMBLE_PRIME = 0x9E3779B1u;
+
+#if defined(LUAFILE_MAP_AVX2)
+    /// Mix one 32 byte block into the four hash lanes
+    static void accumulate(__m256i& acc, __m256i data, __m256i secret)
+    {
+      __m256i key = _mm256_xor_si256(data, secret);
+      __m256i product = _mm256_mul_epu32(key, _mm256_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+      acc = _mm256_add_epi64(acc, _mm256_add_epi64(_mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)), product));
+    }
+
+    /// acc = (acc ^ (acc >> 47)) * SCRAMBLE_PRIME in each lane (64-bit product from two 32-bit ones)
+    static void scramble(__m256i& acc)
+    {
+      const __m256i prime = _mm256_set1_epi32(static_cast<int>(SCRAMBLE_PRIME));
+      acc = _mm256_xor_si256(acc, _mm256_srli_epi64(acc, 47));
+      __m256i low = _mm256_mul_epu32(acc, prime);
+      __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(acc, 32), prime);
+      acc = _mm256_add_epi64(low, _mm256_slli_epi64(high, 32));
+    }
+#elif defined(LUAFILE_MAP_SSE2)
+    /// Mix 16 bytes of a block into two of the hash lanes
+    static void accumulate(__m128i& acc, __m128i data, __m128i secret)
+    {
+      __m128i key = _mm_xor_si128(data, secret);
+      __m128i product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+      acc = _mm_add_epi64(acc, _mm_add_epi64(_mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2)), product));
+    }
+
+    /// acc = (acc ^ (acc >> 47)) * SCRAMBLE_PRIME in each lane (64-bit product from two 32-bit ones)
+    static void scramble(__m128i& acc)
+    {
+      const __m128i prime = _mm_set1_epi32(static_cast<int>(SCRAMBLE_PRIME));
+      acc = _mm_xor_si128(acc, _mm_srli_epi64(acc, 47));
+      __m128i low = _mm_mul_epu32(acc, prime);
+      __m128i high = _mm_mul_epu32(_mm_srli_epi64(acc, 32), prime);
+      acc = _mm_add_epi64(low, _mm_slli_epi64(high, 32));
+    }
+#else
+    /// Mix one 32 byte block into the four hash lanes
+    static void accumulate(uint64_t acc[4], const char* block, const uint64_t secret[4])
+    {
+      uint64_t data[4];
+      for (int lane = 0; lane < 4; ++lane) {
+        data[lane] = load64(block + 8 * lane);
+      }
+      for (int lane = 0; lane < 4; ++lane) {
+        uint64_t key = data[lane] ^ secret[lane];
+        acc[lane] += data[lane ^ 1] + (key & 0xFFFFFFFFULL) * (key >> 32);
+      }
+    }
+
+    /// acc = (acc ^ (acc >> 47)) * SCRAMBLE_PRIME in each lane
+    static void scramble(uint64_t acc[4])
+    {
+      for (int lane = 0; lane < 4; ++lane) {
+        acc[lane] = (acc[lane] ^ (acc[lane] >> 47)) * SCRAMBLE_PRIME;
+      }
+    }
+#endif
+
+#if defined(LUAFILE_MAP_SSE2)
+    /// Bit i is set if byte i of a and b differ
+    static uint32_t mismatchMask16(const char* a, const char* b)
+    {
+      __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+      __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+      return ~static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb))) & 0xFFFFu;
+    }
+
+    static size_t countTrailingZeros(uint32_t mask)
+    {
+#ifdef _MSC_VER
+      unsigned long index;
+      _BitScanForward(&index, mask);
+      return index;
+#else
+      return __builtin_ctz(mask);
+#endif
+    }
+#endif
+
+    static uint64_t load64(const char* p)
+    {
+      uint64_t value;
+      memcpy(&value, p, sizeof(value));
+      return value;
+    }
+
+    static uint64_t rotateLeft(uint64_t value, int bits)
+    {
+      return (value << bits) | (value >> (64 - bits));
+    }
+  };
+
+  /// Hash of parameter names for unordered containers
+  struct LuaFileMap_KeyHash
+  {
+    size_t operator()(const std::string& key) const
+    {
+      return static_cast<size_t>(LuaFileMap_KeyOps::hash(key.data(), key.size()));
+    }
+  };
+
+  /// Equality of parameter names for unordered containers
+  struct LuaFileMap_KeyEqual
+  {
+    bool operator()(const std::string& a, const std::string& b) const
+    {
+      return LuaFileMap_KeyOps::equal(a.data(), a.size(), b.data(), b.size());
+    }
+  };
+
+  /// Names set by Lua itself which must not become parameters
+  /**
+   * Replaces a chain of strcmp calls: all the names are short, so a name is
+   * rejected on its length before any character is compared.
+   */
+  class LuaFileMap_ReservedNames
+  {
+
+  public:
+    /// Value type for which a name is reserved
+    enum Kind { NUMBER, STRING, TABLE };
+
+    /// True if the name is reserved by Lua for this kind of value
+    static bool contains(Kind kind, const char* name, size_t length)
+    {
+      if (length > MAX_LENGTH) {
+        return false;
+      }
+      const Entry* entries = table();
+      for (const Entry* entry = entries; entry->name != NULL; ++entry) {
+        if (entry->length == length && entry->kind == kind &&
+            memcmp(entry->name, name, length) == 0) {
+          return true;
+        }
+      }
+      return false;
+    }
+
+  private:
+    static const size_t MAX_LENGTH = 14;  // longest name of table()
+
+    struct Entry
+    {
+      const char* name;
+      size_t length;
+      Kind kind;
+    };
+
+    static const Entry* table()
+    {
+      static const Entry entries[] = {
+        { "math.huge", 9, NUMBER },
+        { "math.pi", 7, NUMBER },
+        { "_VERSION", 8, STRING },
+        { "package.cpath", 13, STRING },
+        { "package.config", 14, STRING },
+        { "package.path", 12, STRING },
+        { "_G", 2, TABLE },
+        { "package.loaded", 14, TABLE },
+        { NULL, 0, NUMBER }
+      };
+      return entries;
+    }
+  };
+
+#endif
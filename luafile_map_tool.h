@@ -15,10 +15,15 @@
 #ifndef __LUAFILE_MAP_TOOL_H__
 #define __LUAFILE_MAP_TOOL_H__
 
-#include <map>
+#include <unordered_map>
 #include <string>
+#include <cstring>
 #include <iostream>
 #include <cmath>
+#include <stdint.h>
+
+#include "luafile_key_ops.h"
+#include "luafile_compact_store.h"
 
 // Set to true (or use -DGC_LUA_VERBOSE=true argument) to show the parameters set
 #ifndef GC_LUA_VERBOSE
@@ -56,7 +61,8 @@ extern "C" {
   /// Tool which reads a Lua configuration file and sets parameters in maps.
   /**
    * Lua Config File Tool which reads a configuration file and stores the parameters
-   * in std::map containers according to their types (double, long, string).
+   * in hashed containers according to their types (double, long, string). The names
+   * are hashed and compared with LuaFileMap_KeyOps (SSE2/AVX2 when available).
    *
    * One instance can be used to read and configure several lua config files.
    */
@@ -65,25 +71,70 @@ extern "C" {
   {
   
   public:
-    typedef std::map<std::string, double> DoubleMap;
-    typedef std::map<std::string, long> LongMap;
-    typedef std::map<std::string, std::string> StringMap;
+    typedef std::unordered_map<std::string, double, LuaFileMap_KeyHash, LuaFileMap_KeyEqual> DoubleMap;
+    typedef std::unordered_map<std::string, long, LuaFileMap_KeyHash, LuaFileMap_KeyEqual> LongMap;
+    typedef std::unordered_map<std::string, std::string, LuaFileMap_KeyHash, LuaFileMap_KeyEqual> StringMap;
+
+    typedef LuaFileMap_TypeMemoryStats TypeMemoryStats;
+    typedef LuaFileMap_MemoryStats MemoryStats;
+    typedef LuaFileMap_CompactionReport CompactionReport;
 
     /// Get the singleton instance
     /**
      * @param lua_cfg_file Path to the Lua config file (can be NULL to just get the instance)
      * @param reset If true, clear existing maps before loading; if false, append to existing maps
+     * @param compact If true, compact the parameters after loading (see compact())
      * @return Reference to the singleton instance
      */
-    static const LuaFileMap_Tool& instance(const char* lua_cfg_file = NULL, bool reset = false)
+    static const LuaFileMap_Tool& instance(const char* lua_cfg_file = NULL, bool reset = false,
+                                           bool compact = false)
     {
       static LuaFileMap_Tool instance;
       if (lua_cfg_file != NULL) {
         instance.config(lua_cfg_file, reset);
       }
+      if (compact) {
+        instance.compact();
+      }
       return instance;
     }
 
+    /// Estimate the memory used by the loaded parameters
+    MemoryStats memoryStats() const
+    {
+      if (mCompacted) {
+        return mCompactStore.memoryStats();
+      }
+
+      MemoryStats stats;
+      const size_t node_header = sizeof(void*) + sizeof(size_t);  // next pointer + cached hash
+      for (DoubleMap::const_iterator it = mDoubleMap.begin(); it != mDoubleMap.end(); ++it) {
+        stats.doubles.addEntry(it->first, sizeof(double),
+                               node_header + sizeof(DoubleMap::value_type));
+      }
+      for (LongMap::const_iterator it = mLongMap.begin(); it != mLongMap.end(); ++it) {
+        stats.longs.addEntry(it->first, sizeof(long),
+                             node_header + sizeof(LongMap::value_type));
+      }
+      for (StringMap::const_iterator it = mStringMap.begin(); it != mStringMap.end(); ++it) {
+        stats.strings.addEntry(it->first, it->second.size(),
+                               node_header + sizeof(StringMap::value_type)
+                               + TypeMemoryStats::stringHeapBytes(it->second));
+      }
+
+      // bucket arrays
+      stats.doubles.overhead_bytes += bucketBytes(mDoubleMap);
+      stats.longs.overhead_bytes += bucketBytes(mLongMap);
+      stats.strings.overhead_bytes += bucketBytes(mStringMap);
+      return stats;
+    }
+
+    /// True if the parameters are currently stored in compacted form
+    bool isCompacted() const { return mCompacted; }
+
+    /// Memory usage before and after the compaction (all zero if not compacted)
+    const CompactionReport& getCompactionReport() const { return mCompactionReport; }
+
     /// Get a double value from the map, with cross-type lookup
     /**
      * @param val Reference to store the value
@@ -92,19 +143,20 @@ extern "C" {
      */
     bool getDouble(double& val, const char* param_name) const
     {
+      // Build the key once for both lookups
+      const std::string name(param_name);
+
       // First try to find it in the double map
-      auto it = mDoubleMap.find(param_name);
-      if (it != mDoubleMap.end()) {
-        val = it->second;
+      if (findDouble(val, name)) {
         return true;
       }
       
       // If not found, try to find it in the long map and convert
-      auto long_it = mLongMap.find(param_name);
-      if (long_it != mLongMap.end()) {
-        val = static_cast<double>(long_it->second);
+      long long_val;
+      if (findLong(long_val, name)) {
+        val = static_cast<double>(long_val);
         std::cout << "warning :  found " << param_name << " in other list :   " 
-                  << long_it->second << " ->  " << val << std::endl;
+                  << long_val << " ->  " << val << std::endl;
         return true;
       }
       
@@ -120,12 +172,7 @@ extern "C" {
      */
     bool getString(std::string& val, const char* param_name) const
     {
-      auto it = mStringMap.find(param_name);
-      if (it != mStringMap.end()) {
-        val = it->second;
-        return true;
-      }
-      return false;
+      return findString(val, std::string(param_name));
     }
     
     /// Template function to get integer values with different bit sizes, with cross-type lookup
@@ -138,17 +185,19 @@ extern "C" {
     template<typename T>
     bool getInteger(T& val, const char* param_name) const
     {
+      // Build the key once for both lookups
+      const std::string name(param_name);
+
       // First try to find it in the long map
-      auto long_it = mLongMap.find(param_name);
-      if (long_it != mLongMap.end()) {
-        val = static_cast<T>(long_it->second);
+      long found_long;
+      if (findLong(found_long, name)) {
+        val = static_cast<T>(found_long);
         return true;
       }
       
       // If not found, try to find it in the double map and convert
-      auto double_it = mDoubleMap.find(param_name);
-      if (double_it != mDoubleMap.end()) {
-        double double_val = double_it->second;
+      double double_val;
+      if (findDouble(double_val, name)) {
         // Convert double to integer (force conversion even for non-integer values)
         long long_val = static_cast<long>(double_val);
         val = static_cast<T>(long_val);
@@ -166,8 +215,8 @@ extern "C" {
   private:
     /// Private constructor for singleton
     LuaFileMap_Tool()
+      : mCompacted(false)
     {
-      // Constructor left empty
     }
     
     /// Private destructor
@@ -193,6 +242,11 @@ extern "C" {
         mDoubleMap.clear();
         mLongMap.clear();
         mStringMap.clear();
+        clearCompacted();
+      }
+      else if (mCompacted) {
+        // new parameters are merged into the maps, compact() again afterwards if needed
+        expandCompacted();
       }
 
       // start Lua
@@ -255,23 +309,63 @@ extern "C" {
      */
     bool getLong(long& val, const char* param_name) const
     {
-      auto it = mLongMap.find(param_name);
-      if (it != mLongMap.end()) {
-        val = it->second;
-        return true;
-      }
-      return false;
+      return findLong(val, std::string(param_name));
     }
 
-    /// Get reference to the double map
+    /// Get reference to the double map (empty while compacted)
     const DoubleMap& getDoubleMap() const { return mDoubleMap; }
     
-    /// Get reference to the long map
+    /// Get reference to the long map (empty while compacted)
     const LongMap& getLongMap() const { return mLongMap; }
     
-    /// Get reference to the string map
+    /// Get reference to the string map (empty while compacted)
     const StringMap& getStringMap() const { return mStringMap; }
 
+    /// Compacts the loaded parameters
+    /**
+     * Moves the parameters out of the maps into a LuaFileMap_CompactStore, where shared
+     * name prefixes, identical segments and identical string values are stored once.
+     * The getters keep working on the compact store; the maps stay empty until the
+     * next config() call.
+     */
+    void compact()
+    {
+      if (mCompacted) {
+        return;
+      }
+      mCompactionReport.before = memoryStats();
+
+      mCompactStore.build(mDoubleMap, mLongMap, mStringMap);
+      DoubleMap().swap(mDoubleMap);
+      LongMap().swap(mLongMap);
+      StringMap().swap(mStringMap);
+      mCompacted = true;
+
+      mCompactionReport.after = memoryStats();
+      if (GC_LUA_VERBOSE) fprintf(stderr, "(COMPACT) %lu -> %lu bytes (saved %lu)\n",
+                                  (unsigned long)mCompactionReport.before.total(),
+                                  (unsigned long)mCompactionReport.after.total(),
+                                  (unsigned long)mCompactionReport.savedBytes());
+    }
+
+    /// Moves the parameters of the compact store back into the maps
+    void expandCompacted()
+    {
+      if (!mCompacted) {
+        return;
+      }
+      mCompactStore.expand(mDoubleMap, mLongMap, mStringMap);
+      clearCompacted();
+    }
+
+    /// Drops the compact store and the report of its compaction
+    void clearCompacted()
+    {
+      mCompactStore.clear();
+      mCompacted = false;
+      mCompactionReport = CompactionReport();
+    }
+
   protected:
 
     /// Maps to store parameters by type
@@ -279,6 +373,60 @@ extern "C" {
     LongMap mLongMap;
     StringMap mStringMap;
 
+    /// Compact store (only used when mCompacted is true)
+    bool mCompacted;
+    LuaFileMap_CompactStore mCompactStore;
+    CompactionReport mCompactionReport;
+
+    /// Bytes of the bucket array of a hashed map (0 until the map allocates one)
+    template<typename MapT>
+    static size_t bucketBytes(const MapT& map)
+    {
+      return map.empty() ? 0 : map.bucket_count() * sizeof(void*);
+    }
+
+    /// Look up a parameter in the double map or in the compact store
+    bool findDouble(double& val, const std::string& param_name) const
+    {
+      if (mCompacted) {
+        return mCompactStore.findDouble(val, param_name.c_str());
+      }
+      auto it = mDoubleMap.find(param_name);
+      if (it != mDoubleMap.end()) {
+        val = it->second;
+        return true;
+      }
+      return false;
+    }
+
+    /// Look up a parameter in the long map or in the compact store
+    bool findLong(long& val, const std::string& param_name) const
+    {
+      if (mCompacted) {
+        return mCompactStore.findLong(val, param_name.c_str());
+      }
+      auto it = mLongMap.find(param_name);
+      if (it != mLongMap.end()) {
+        val = it->second;
+        return true;
+      }
+      return false;
+    }
+
+    /// Look up a parameter in the string map or in the compact store
+    bool findString(std::string& val, const std::string& param_name) const
+    {
+      if (mCompacted) {
+        return mCompactStore.findString(val, param_name.c_str());
+      }
+      auto it = mStringMap.find(param_name);
+      if (it != mStringMap.end()) {
+        val = it->second;
+        return true;
+      }
+      return false;
+    }
+
     /// Traverse a Lua table setting global variables as parameters (recursive)
     /**
      * @param L Lua state
@@ -295,6 +443,7 @@ extern "C" {
       int should_inc_integer_index_count;
       int integer_index_count = 0;
       char *next_level;
+      size_t key_length;
       if (level == NULL) {
         key = static_key;
         level = key;
@@ -350,15 +499,14 @@ extern "C" {
           fprintf(stderr, "Error loading lua file: invalid key");
           return -1;
         }
+        key_length = next_level - key;
 
         /* set key value in the database */
         switch(lua_type(L, -1)) {
 
         case LUA_TNUMBER:
           // Avoid setting some Lua specific values as parameters
-          if (strcmp(key, "math.huge") == 0 ||
-              strcmp(key, "math.pi") == 0 ||
-              0) {
+          if (LuaFileMap_ReservedNames::contains(LuaFileMap_ReservedNames::NUMBER, key, key_length)) {
             if (GC_LUA_DEBUG) fprintf(stderr, "(%s) %s   (ignored because it's Lua specific)\n", lua_typename(L, lua_type(L, -1)), key);
           }
           else {
@@ -369,14 +517,14 @@ extern "C" {
               lua_Integer intVal = lua_tointeger(L, -1);
               
               // Store in long map
-              mLongMap[std::string(key)] = (long)intVal;
+              mLongMap[std::string(key, key_length)] = (long)intVal;
               if (GC_LUA_VERBOSE) fprintf(stderr, "(SET LONG) %s = %ld\n", key, (long)intVal);
             } else {
               // This is a float
               lua_Number numVal = lua_tonumber(L, -1);
               
               // Store in double map
-              mDoubleMap[std::string(key)] = (double)numVal;
+              mDoubleMap[std::string(key, key_length)] = (double)numVal;
               if (GC_LUA_VERBOSE) fprintf(stderr, "(SET DOUBLE) %s = %f\n", key, (double)numVal);
             }
             #else
@@ -385,12 +533,12 @@ extern "C" {
             // test if it is an integer
             if ((long long) num == num) {
               // Store in long map
-              mLongMap[std::string(key)] = (long)num;
+              mLongMap[std::string(key, key_length)] = (long)num;
               if (GC_LUA_VERBOSE) fprintf(stderr, "(SET LONG) %s = %ld\n", key, (long)num);
             }
             else {
               // Store in double map
-              mDoubleMap[std::string(key)] = (double)num;
+              mDoubleMap[std::string(key, key_length)] = (double)num;
               if (GC_LUA_VERBOSE) fprintf(stderr, "(SET DOUBLE) %s = %f\n", key, (double)num);
             }
             #endif
@@ -402,7 +550,7 @@ extern "C" {
           {
             bool boolVal = lua_toboolean(L, -1);
             // Store boolean as long (0 or 1)
-            mLongMap[std::string(key)] = boolVal ? 1 : 0;
+            mLongMap[std::string(key, key_length)] = boolVal ? 1 : 0;
             if (GC_LUA_VERBOSE) fprintf(stderr, "(SET BOOL/LONG) %s = %s\n", key, boolVal? "true":"false");
             if (should_inc_integer_index_count) ++integer_index_count;
           }
@@ -410,17 +558,13 @@ extern "C" {
 
         case LUA_TSTRING:
           // Avoid setting some Lua specific values as parameters
-          if (strcmp(key, "_VERSION") == 0 ||
-              strcmp(key, "package.cpath") == 0 ||
-              strcmp(key, "package.config") == 0 ||
-              strcmp(key, "package.path") == 0 ||
-              0) {
+          if (LuaFileMap_ReservedNames::contains(LuaFileMap_ReservedNames::STRING, key, key_length)) {
             if (GC_LUA_DEBUG) fprintf(stderr, "(%s) %s   (ignored because it's Lua specific)\n", lua_typename(L, lua_type(L, -1)), key);
           }
           else {
             std::string strVal = lua_tostring(L, -1);
             // Store in string map
-            mStringMap[std::string(key)] = strVal;
+            mStringMap[std::string(key, key_length)] = strVal;
             if (GC_LUA_VERBOSE) fprintf(stderr, "(SET STRING) %s = %s\n", key, strVal.c_str());
             if (should_inc_integer_index_count) ++integer_index_count;
           }
@@ -428,8 +572,7 @@ extern "C" {
 
         case LUA_TTABLE:
           // Avoid recursion on some tables
-          if (strcmp(key, "_G") == 0 ||
-              strcmp(key, "package.loaded") == 0) {
+          if (LuaFileMap_ReservedNames::contains(LuaFileMap_ReservedNames::TABLE, key, key_length)) {
             if (GC_LUA_DEBUG) fprintf(stderr, "(%s) %s   (ignored to avoid recursion)\n", lua_typename(L, lua_type(L, -1)), key);
           }
           else {
@@ -0,0 +1,108 @@
+// Round trip test of LuaFileMap_CompactStore (does not need Lua):
+// maps -> build() -> every name looked up -> expand() -> same maps
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <cstdio>
+
+#include "luafile_compact_store.h"
+
+typedef std::map<std::string, double> DoubleMap;
+typedef std::map<std::string, long> LongMap;
+typedef std::map<std::string, std::string> StringMap;
+
+static int failures = 0;
+
+static void check(bool ok, const std::string& what) {
+    if (!ok) {
+        std::cout << "FAILED: " << what << std::endl;
+        ++failures;
+    }
+}
+
+int main() {
+    DoubleMap doubles;
+    LongMap longs;
+    StringMap strings;
+
+    // flattened tables with long shared prefixes
+    char name[128];
+    for (int cpu = 0; cpu < 64; ++cpu) {
+        snprintf(name, sizeof(name), "platform.cluster0.cpu.%d.cache.l2.", cpu);
+        longs[std::string(name) + "size"] = 1024 * cpu;
+        doubles[std::string(name) + "latency"] = cpu * 0.5;
+        strings[std::string(name) + "policy"] = cpu % 2 ? "write-back" : "write-through";  // shared values
+    }
+
+    // a name which is both a parameter and a prefix, a name in two types
+    longs["memory"] = 1;
+    strings["memory.ram"] = "8GB";
+    doubles["cores"] = 4.5;
+    longs["cores"] = 4;
+
+    // empty segments, a dot inside a Lua key (["a.b"] flattens like a.b) and bytes >= 0x80
+    longs[""] = 10;
+    longs["a..b"] = 11;
+    longs[".lead"] = 12;
+    longs["trail."] = 13;
+    strings["a.b"] = "";
+    strings["caf\xc3\xa9.\xff"] = "\xe2\x82\xac";
+    doubles["\x80"] = -1.25;
+
+    LuaFileMap_CompactStore store;
+    store.build(doubles, longs, strings);
+
+    // every parameter is found with its value
+    for (DoubleMap::const_iterator it = doubles.begin(); it != doubles.end(); ++it) {
+        double val = 0;
+        check(store.findDouble(val, it->first.c_str()) && val == it->second, "double " + it->first);
+    }
+    for (LongMap::const_iterator it = longs.begin(); it != longs.end(); ++it) {
+        long val = 0;
+        check(store.findLong(val, it->first.c_str()) && val == it->second, "long " + it->first);
+    }
+    for (StringMap::const_iterator it = strings.begin(); it != strings.end(); ++it) {
+        std::string val = "unset";
+        check(store.findString(val, it->first.c_str()) && val == it->second, "string " + it->first);
+    }
+
+    // prefixes, other types and unknown names are not found
+    long long_val;
+    double double_val;
+    std::string string_val;
+    check(!store.findLong(long_val, "platform.cluster0.cpu"), "prefix is not a parameter");
+    check(!store.findLong(long_val, "platform.cluster0.cpu.3.cache.l2.size.x"), "name below a leaf");
+    check(!store.findDouble(double_val, "memory"), "long is not a double");
+    check(!store.findString(string_val, "memory.rom"), "unknown sibling");
+    check(!store.findLong(long_val, "a."), "unknown empty segment");
+    check(!store.findLong(long_val, "zzz"), "unknown name");
+
+    // the segments and values are pooled
+    LuaFileMap_MemoryStats stats = store.memoryStats();
+    check(stats.strings.entries == strings.size(), "string entry count");
+    check(stats.longs.entries == longs.size() && stats.doubles.entries == doubles.size(), "number entry count");
+
+    // expanding gives the same maps back
+    DoubleMap expanded_doubles;
+    LongMap expanded_longs;
+    StringMap expanded_strings;
+    store.expand(expanded_doubles, expanded_longs, expanded_strings);
+    check(expanded_doubles == doubles, "expanded doubles");
+    check(expanded_longs == longs, "expanded longs");
+    check(expanded_strings == strings, "expanded strings");
+
+    // an empty store finds nothing and expands to nothing
+    store.clear();
+    check(!store.findLong(long_val, "memory"), "cleared store");
+    LongMap empty_longs;
+    store.expand(expanded_doubles, empty_longs, expanded_strings);
+    check(empty_longs.empty(), "cleared store expands to nothing");
+
+    if (failures != 0) {
+        std::cout << failures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "compact store round trip: ok" << std::endl;
+    return 0;
+}